@@ -0,0 +1,154 @@
+#pragma once
+
+#include "shared.h"
+#include "unique.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Bump allocator for short-lived objects: nothing is freed one by one, `Reset` (or the
+// destructor) drops every chunk at once. Objects still run their destructors when their last
+// owner goes away; for trivially destructible types that costs nothing. In debug builds the
+// arena counts outstanding handles and asserts none of them outlives it.
+class Arena {
+public:
+    explicit Arena(size_t chunk_size = 64 * 1024) : chunk_size_(chunk_size) {
+    }
+    Arena(const Arena& other) = delete;
+    Arena& operator=(const Arena& other) = delete;
+
+    ~Arena() {
+        Reset();
+    }
+
+    void* Allocate(size_t size, size_t align) {
+        uintptr_t address = Align(cursor_, align);
+        if (cursor_ == nullptr || address + size > reinterpret_cast<uintptr_t>(end_)) {
+            NewChunk(size + align);
+            address = Align(cursor_, align);
+        }
+        cursor_ = reinterpret_cast<char*>(address + size);
+        return reinterpret_cast<void*>(address);
+    }
+
+    void Reset() {
+        assert(handles_ == 0 && "SharedPtr/UniquePtr outlives its Arena");
+        while (head_ != nullptr) {
+            Chunk* prev = head_->prev;
+            ::operator delete(head_);
+            head_ = prev;
+        }
+        cursor_ = nullptr;
+        end_ = nullptr;
+    }
+
+#ifndef NDEBUG
+    void Track() {
+        ++handles_;
+    }
+    void Untrack() {
+        --handles_;
+    }
+    size_t Handles() const {
+        return handles_;
+    }
+#endif
+
+private:
+    struct Chunk {
+        Chunk* prev;
+    };
+
+    static uintptr_t Align(char* ptr, size_t align) {
+        return (reinterpret_cast<uintptr_t>(ptr) + align - 1) & ~static_cast<uintptr_t>(align - 1);
+    }
+
+    void NewChunk(size_t min_size) {
+        size_t size = std::max(chunk_size_, sizeof(Chunk) + min_size);
+        auto chunk = static_cast<Chunk*>(::operator new(size));
+        chunk->prev = head_;
+        head_ = chunk;
+        cursor_ = reinterpret_cast<char*>(chunk + 1);
+        end_ = reinterpret_cast<char*>(chunk) + size;
+    }
+
+    size_t chunk_size_;
+    Chunk* head_ = nullptr;
+    char* cursor_ = nullptr;
+    char* end_ = nullptr;
+#ifndef NDEBUG
+    size_t handles_ = 0;
+#endif
+};
+
+// Control block and object placed in an arena; the memory is returned by `Arena::Reset`
+template <class T>
+class ArenaBlock : public ObjectBlock<T> {
+public:
+    template <typename... Args>
+    ArenaBlock([[maybe_unused]] Arena& arena, Args&&... args)
+        : ObjectBlock<T>(std::forward<Args>(args)...) {
+#ifndef NDEBUG
+        arena_ = &arena;
+        arena_->Track();
+#endif
+    }
+    // The object is already gone and the block holds nothing else worth destroying
+    void Destroy() override {
+#ifndef NDEBUG
+        arena_->Untrack();
+#endif
+    }
+
+private:
+#ifndef NDEBUG
+    Arena* arena_;
+#endif
+};
+
+struct ArenaDeleter {
+    ArenaDeleter() {
+    }
+    explicit ArenaDeleter([[maybe_unused]] Arena& arena) {
+#ifndef NDEBUG
+        arena_ = &arena;
+#endif
+    }
+    template <class T>
+    void operator()(T* ptr) {
+        if (ptr == nullptr) {
+            return;
+        }
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            ptr->~T();
+        }
+#ifndef NDEBUG
+        arena_->Untrack();
+#endif
+    }
+
+#ifndef NDEBUG
+    Arena* arena_ = nullptr;
+#endif
+};
+
+template <typename T, typename... Args>
+SharedPtr<T> MakeSharedIn(Arena& arena, Args&&... args) {
+    void* memory = arena.Allocate(sizeof(ArenaBlock<T>), alignof(ArenaBlock<T>));
+    auto block = new (memory) ArenaBlock<T>(arena, std::forward<Args>(args)...);
+    return SharedPtr<T>(static_cast<ObjectBlock<T>*>(block));
+}
+
+template <typename T, typename... Args>
+UniquePtr<T, ArenaDeleter> MakeUniqueIn(Arena& arena, Args&&... args) {
+    void* memory = arena.Allocate(sizeof(T), alignof(T));
+    T* ptr = new (memory) T(std::forward<Args>(args)...);
+#ifndef NDEBUG
+    arena.Track();
+#endif
+    return UniquePtr<T, ArenaDeleter>(ptr, ArenaDeleter(arena));
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "shared.h"
+
+#include <cassert>
+#include <cstddef>  // std::nullptr_t
+
+// Non-owning view of a `SharedPtr` for passing down call chains: taking, copying and dropping a
+// borrow never touches the control block. The caller must keep an owner alive for as long as
+// the borrow is used; `Upgrade` gives the callee an owner of its own to keep.
+//
+// With SMARTPTRS_CHECK_BORROWS defined every borrow pins the block with a weak reference and
+// asserts on access that an owner is still alive.
+template <typename T>
+class BorrowedPtr {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    template <typename Y>
+    friend class BorrowedPtr;
+
+    BorrowedPtr() {
+    }
+    BorrowedPtr(std::nullptr_t) {
+    }
+    template <class Y>
+    BorrowedPtr(const SharedPtr<Y>& owner) : data_(owner.Get()), block_(owner.GetBlock()) {
+        Pin();
+    }
+    // A borrow of a temporary would dangle as soon as it is stored
+    template <class Y>
+    BorrowedPtr(SharedPtr<Y>&& owner) = delete;
+    template <class Y>
+    BorrowedPtr(const BorrowedPtr<Y>& other) : data_(other.data_), block_(other.block_) {
+        Pin();
+    }
+    BorrowedPtr(const BorrowedPtr& other) : data_(other.data_), block_(other.block_) {
+        Pin();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    BorrowedPtr& operator=(const BorrowedPtr& other) {
+        BorrowedPtr(other).Swap(*this);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~BorrowedPtr() {
+#ifdef SMARTPTRS_CHECK_BORROWS
+        if (block_ != nullptr) {
+            block_->ReleaseWeak();
+        }
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Swap(BorrowedPtr& other) {
+        std::swap(data_, other.data_);
+        std::swap(block_, other.block_);
+    }
+
+    // Takes a reference of its own, for callees that keep the object
+    SharedPtr<T> Upgrade() const {
+        Check();
+        return SharedPtr<T>(block_, data_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        Check();
+        return data_;
+    }
+    T& operator*() const {
+        Check();
+        return *data_;
+    }
+    T* operator->() const {
+        Check();
+        return data_;
+    }
+    explicit operator bool() const {
+        return data_ != nullptr;
+    }
+    ControlBlock* GetBlock() const {
+        return block_;
+    }
+
+private:
+    void Pin() {
+#ifdef SMARTPTRS_CHECK_BORROWS
+        if (block_ != nullptr) {
+            block_->AddWeak();
+        }
+#endif
+    }
+    void Check() const {
+#ifdef SMARTPTRS_CHECK_BORROWS
+        assert((block_ == nullptr || block_->GetCnt() > 0) && "BorrowedPtr outlived its owners");
+#endif
+    }
+
+    T* data_ = nullptr;
+    ControlBlock* block_ = nullptr;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "shared.h"
+
+#include <utility>
+
+// Copy-on-write value wrapper: copies share one payload, the first write through a shared
+// copy clones it. Only `CowPtr` itself owns the payload and it never hands out `WeakPtr`s, so
+// the sole owner cannot gain new sharers behind its back. Like the counts it relies on, this is
+// not thread-safe: copies of one payload must not be written and read from different threads.
+template <typename T>
+class CowPtr {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    CowPtr() : data_(MakeShared<T>()) {
+    }
+    explicit CowPtr(const T& value) : data_(MakeShared<T>(value)) {
+    }
+    explicit CowPtr(T&& value) : data_(MakeShared<T>(std::move(value))) {
+    }
+    // No move operations: moving would leave an empty `CowPtr` behind, while a copy only bumps
+    // the count, so rvalues are copied and the source stays a usable value
+    CowPtr(const CowPtr& other) = default;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    CowPtr& operator=(const CowPtr& other) = default;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    // Unshares the payload if needed; the reference stays valid for any number of writes
+    // until this `CowPtr` is copied, assigned or destroyed
+    T& Write() {
+        Detach();
+        return *data_;
+    }
+    // Runs all writes in `f` behind a single uniqueness check
+    template <class F>
+    decltype(auto) Mutate(F&& f) {
+        Detach();
+        return std::forward<F>(f)(*data_);
+    }
+    void Swap(CowPtr& other) {
+        data_.Swap(other.data_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    const T& Read() const {
+        return *data_;
+    }
+    const T& operator*() const {
+        return *data_;
+    }
+    const T* operator->() const {
+        return data_.Get();
+    }
+    const T* Get() const {
+        return data_.Get();
+    }
+    size_t UseCount() const {
+        return data_.UseCount();
+    }
+    bool IsUnique() const {
+        return data_.UseCount() == 1;
+    }
+
+private:
+    void Detach() {
+        if (data_.UseCount() > 1) {
+            data_ = MakeShared<T>(static_cast<const T&>(*data_));
+        }
+    }
+
+    SharedPtr<T> data_;
+};
@@ -0,0 +1,253 @@
+#pragma once
+
+#include "shared.h"
+
+#include <cstdint>
+#include <deque>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Opt-in cycle collection by trial deletion (Bacon & Rajan, "Concurrent Cycle Collection in
+// Reference Counted Systems", synchronous variant). Objects created by `MakeTraced` report
+// their `SharedPtr` members through
+//     void Trace(Tracer& tracer) { tracer(left_); tracer(right_); }
+// Whenever such an object loses a reference but stays alive it becomes a candidate root;
+// `CycleCollector::Collect` then frees the candidates that are only kept alive by each other.
+// Collection can be spread over calls by limiting the roots taken per call, but each call runs
+// to completion over the graphs it touches: the pause is bounded per root, not per node.
+// Like the counts themselves, the collector is not thread-safe.
+
+// Visits the `SharedPtr` edges of one traced object
+class Tracer {
+public:
+    using Visit = void (*)(TracedNode* child, void* context);
+
+    Tracer(Visit visit, void* context) : visit_(visit), context_(context) {
+    }
+
+    template <class Y>
+    void operator()(SharedPtr<Y>& edge) {
+        if (visit_ == nullptr) {
+            edge.Reset();
+            return;
+        }
+        ControlBlock* block = edge.GetBlock();
+        if (block != nullptr && block->IsTraced()) {
+            visit_(block->AsTraced(), context_);
+        }
+    }
+
+    // Resets every edge instead of visiting it
+    static Tracer Breaker() {
+        return Tracer(nullptr, nullptr);
+    }
+
+private:
+    Visit visit_;
+    void* context_;
+};
+
+class TracedNode {
+public:
+    enum class Color : uint8_t {
+        Black,    // In use or free
+        Gray,     // Possible member of a cycle
+        White,    // Member of a garbage cycle
+        Purple,   // Possible root of a cycle
+        Garbage,  // Being freed by the collector
+    };
+
+    virtual void TraceChildren(Tracer& tracer) = 0;
+    virtual ControlBlock* Block() = 0;
+
+    Color color = Color::Black;
+    bool buffered = false;
+
+protected:
+    ~TracedNode() = default;
+};
+
+class CycleCollector {
+public:
+    using Color = TracedNode::Color;
+
+    // Never destroyed, so it outlives every `SharedPtr` including the static ones
+    static CycleCollector& Instance() {
+        static CycleCollector* instance = new CycleCollector();
+        return *instance;
+    }
+
+    // A traced block lost a reference and is still alive. While buffered the block holds a
+    // weak reference, so its memory stays valid even if the object dies in the meantime.
+    void Suspect(TracedNode* node) {
+        if (node->color == Color::Garbage) {
+            return;
+        }
+        node->color = Color::Purple;
+        if (!node->buffered) {
+            node->buffered = true;
+            node->Block()->AddWeak();
+            roots_.push_back(node);
+        }
+    }
+
+    size_t Candidates() const {
+        return roots_.size();
+    }
+
+    // Examines at most `max_roots` candidates and keeps the rest for the next call. This limits
+    // the number of roots, not the pause: the whole subgraph reachable from every root taken is
+    // marked, scanned and, if garbage, freed within this one call, so a single root heading a
+    // large graph costs time proportional to that graph. Returns the number of objects freed.
+    size_t Collect(size_t max_roots = SIZE_MAX) {
+        std::vector<TracedNode*> batch;
+        while (!roots_.empty() && batch.size() < max_roots) {
+            TracedNode* node = roots_.front();
+            roots_.pop_front();
+            batch.push_back(node);
+            if (node->color == Color::Purple && node->Block()->GetCnt() > 0) {
+                MarkGray(node);
+            }
+        }
+        for (auto node : batch) {
+            Scan(node);
+        }
+
+        std::vector<TracedNode*> garbage;
+        for (auto node : batch) {
+            node->buffered = false;
+            GatherWhite(node, garbage);
+        }
+        // Put back the references that marking took from the garbage's children, pin every
+        // garbage object and break its edges; the objects then die in the usual way
+        for (auto node : garbage) {
+            ForEachChild(node, [](TracedNode* child) { child->Block()->Add(); });
+        }
+        for (auto node : garbage) {
+            node->Block()->Add();
+        }
+        for (auto node : garbage) {
+            Tracer breaker = Tracer::Breaker();
+            node->TraceChildren(breaker);
+        }
+        for (auto node : garbage) {
+            node->Block()->Release();
+        }
+        for (auto node : batch) {
+            node->Block()->ReleaseWeak();
+        }
+        return garbage.size();
+    }
+
+private:
+    CycleCollector() {
+    }
+
+    template <class F>
+    static void ForEachChild(TracedNode* node, F&& f) {
+        using Callback = std::remove_reference_t<F>;
+        Tracer tracer(
+            [](TracedNode* child, void* context) { (*static_cast<Callback*>(context))(child); },
+            &f);
+        node->TraceChildren(tracer);
+    }
+
+    // Subtracts internal references from everything reachable from `root`
+    static void MarkGray(TracedNode* root) {
+        if (root->color == Color::Gray) {
+            return;
+        }
+        root->color = Color::Gray;
+        std::vector<TracedNode*> stack{root};
+        while (!stack.empty()) {
+            TracedNode* node = stack.back();
+            stack.pop_back();
+            ForEachChild(node, [&](TracedNode* child) {
+                child->Block()->Del();
+                if (child->color != Color::Gray) {
+                    child->color = Color::Gray;
+                    stack.push_back(child);
+                }
+            });
+        }
+    }
+
+    // Gray nodes with references left are externally reachable, as is everything below them
+    static void Scan(TracedNode* root) {
+        std::vector<TracedNode*> stack{root};
+        while (!stack.empty()) {
+            TracedNode* node = stack.back();
+            stack.pop_back();
+            if (node->color != Color::Gray) {
+                continue;
+            }
+            if (node->Block()->GetCnt() > 0) {
+                ScanBlack(node);
+            } else {
+                node->color = Color::White;
+                ForEachChild(node, [&](TracedNode* child) { stack.push_back(child); });
+            }
+        }
+    }
+
+    static void ScanBlack(TracedNode* root) {
+        root->color = Color::Black;
+        std::vector<TracedNode*> stack{root};
+        while (!stack.empty()) {
+            TracedNode* node = stack.back();
+            stack.pop_back();
+            ForEachChild(node, [&](TracedNode* child) {
+                child->Block()->Add();
+                if (child->color != Color::Black) {
+                    child->color = Color::Black;
+                    stack.push_back(child);
+                }
+            });
+        }
+    }
+
+    static void GatherWhite(TracedNode* root, std::vector<TracedNode*>& garbage) {
+        std::vector<TracedNode*> stack{root};
+        while (!stack.empty()) {
+            TracedNode* node = stack.back();
+            stack.pop_back();
+            if (node->color != Color::White) {
+                continue;
+            }
+            node->color = Color::Garbage;
+            garbage.push_back(node);
+            ForEachChild(node, [&](TracedNode* child) { stack.push_back(child); });
+        }
+    }
+
+    std::deque<TracedNode*> roots_;
+};
+
+template <class T>
+class TracedBlock : public ObjectBlock<T>, public TracedNode {
+public:
+    template <typename... Args>
+    TracedBlock(Args&&... args) : ObjectBlock<T>(std::forward<Args>(args)...) {
+        this->traced_ = true;
+    }
+    void Suspect() override {
+        CycleCollector::Instance().Suspect(this);
+    }
+    TracedNode* AsTraced() override {
+        return this;
+    }
+    void TraceChildren(Tracer& tracer) override {
+        this->Get()->Trace(tracer);
+    }
+    ControlBlock* Block() override {
+        return this;
+    }
+};
+
+// `MakeShared` for objects taking part in cycle collection
+template <typename T, typename... Args>
+SharedPtr<T> MakeTraced(Args&&... args) {
+    return SharedPtr<T>(
+        static_cast<ObjectBlock<T>*>(new TracedBlock<T>(std::forward<Args>(args)...)));
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstddef>  // std::nullptr_t
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Polymorphic owner with small-buffer storage: a `Y` derived from `Base` that fits into
+// `Size` bytes aligned to `Align` (and moves without throwing) lives inside the pointer itself,
+// anything else on the heap. The pointer to the object is kept for both cases, so access never
+// branches; each stored type brings a table telling moves how to relocate it.
+template <typename Base, size_t Size = 3 * sizeof(void*), size_t Align = alignof(std::max_align_t)>
+class InlineUniquePtr {
+    struct Ops {
+        // Moves the object to `buffer` if it lives inline, returns where it is afterwards
+        Base* (*relocate)(Base* from, void* buffer);
+        void (*destroy)(Base* ptr);
+    };
+
+public:
+    template <class Y>
+    static constexpr bool kFitsInline = sizeof(Y) <= Size && Align % alignof(Y) == 0 &&
+                                        std::is_nothrow_move_constructible_v<Y>;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    InlineUniquePtr() {
+    }
+    InlineUniquePtr(std::nullptr_t) {
+    }
+    // Adopts a heap object, which `Base`'s destructor must be able to destroy
+    explicit InlineUniquePtr(Base* ptr)
+        : ptr_(ptr), ops_(ptr != nullptr ? &kHeapOps<Base> : nullptr) {
+    }
+    InlineUniquePtr(const InlineUniquePtr& other) = delete;
+    InlineUniquePtr(InlineUniquePtr&& other) noexcept {
+        MoveFrom(other);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    InlineUniquePtr& operator=(const InlineUniquePtr& other) = delete;
+    InlineUniquePtr& operator=(InlineUniquePtr&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            MoveFrom(other);
+        }
+        return *this;
+    }
+    InlineUniquePtr& operator=(std::nullptr_t) {
+        Reset();
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~InlineUniquePtr() {
+        Reset();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    template <class Y, typename... Args>
+    Y& Emplace(Args&&... args) {
+        static_assert(std::is_base_of_v<Base, Y> || std::is_same_v<Base, Y>);
+        Reset();
+        Y* object;
+        if constexpr (kFitsInline<Y>) {
+            object = new (buffer_) Y(std::forward<Args>(args)...);
+            ops_ = &kInlineOps<Y>;
+        } else {
+            object = new Y(std::forward<Args>(args)...);
+            ops_ = &kHeapOps<Y>;
+        }
+        ptr_ = object;
+        return *object;
+    }
+    void Reset() {
+        if (ptr_ != nullptr) {
+            ops_->destroy(ptr_);
+            ptr_ = nullptr;
+            ops_ = nullptr;
+        }
+    }
+    void Swap(InlineUniquePtr& other) {
+        InlineUniquePtr tmp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(tmp);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    Base* Get() const {
+        return ptr_;
+    }
+    explicit operator bool() const {
+        return ptr_ != nullptr;
+    }
+    bool IsInline() const {
+        return ptr_ != nullptr && ops_->relocate != &RelocateHeap;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    Base& operator*() const {
+        return *ptr_;
+    }
+
+    Base* operator->() const {
+        return ptr_;
+    }
+
+private:
+    template <class Y>
+    static Base* RelocateInline(Base* from, void* buffer) {
+        Y* source = static_cast<Y*>(from);
+        Y* target = new (buffer) Y(std::move(*source));
+        source->~Y();
+        return target;
+    }
+    template <class Y>
+    static void DestroyInline(Base* ptr) {
+        static_cast<Y*>(ptr)->~Y();
+    }
+    static Base* RelocateHeap(Base* from, void*) {
+        return from;
+    }
+    template <class Y>
+    static void DestroyHeap(Base* ptr) {
+        delete static_cast<Y*>(ptr);
+    }
+
+    template <class Y>
+    static constexpr Ops kInlineOps{&RelocateInline<Y>, &DestroyInline<Y>};
+    template <class Y>
+    static constexpr Ops kHeapOps{&RelocateHeap, &DestroyHeap<Y>};
+
+    void MoveFrom(InlineUniquePtr& other) noexcept {
+        if (other.ptr_ != nullptr) {
+            ptr_ = other.ops_->relocate(other.ptr_, buffer_);
+            ops_ = other.ops_;
+            other.ptr_ = nullptr;
+            other.ops_ = nullptr;
+        }
+    }
+
+    Base* ptr_ = nullptr;
+    const Ops* ops_ = nullptr;
+    alignas(Align) unsigned char buffer_[Size];
+};
+
+template <typename Base, typename Y, size_t Size = 3 * sizeof(void*),
+          size_t Align = alignof(std::max_align_t), typename... Args>
+InlineUniquePtr<Base, Size, Align> MakeInlineUnique(Args&&... args) {
+    InlineUniquePtr<Base, Size, Align> result;
+    result.template Emplace<Y>(std::forward<Args>(args)...);
+    return result;
+}
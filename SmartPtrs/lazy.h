@@ -0,0 +1,141 @@
+#pragma once
+
+#include "shared.h"
+#include "unique.h"
+#include "weak.h"
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Owner of an object built on first use. The control block is allocated up front and the
+// object is constructed inside it by the first `Get`, so once built the pointer shares, weakens
+// and dies like any `MakeShared` result. After construction every access is one acquire load.
+// Construction is thread-safe; the counts of the resulting `SharedPtr`s are not.
+template <typename T>
+class LazySharedPtr {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    // Builds `T(args...)` on first use. A throwing constructor is retried by the next `Get`, so
+    // the stored arguments are passed as lvalues and stay intact; they are moved only if the
+    // constructor cannot throw, or cannot take them otherwise (move-only arguments), in which
+    // case a retry sees whatever the failed attempt left in them.
+    template <typename... Args>
+    explicit LazySharedPtr(Args&&... args)
+        : LazySharedPtr(FromFactory(),
+                        [args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+                            if constexpr (kMoveArgs<std::unwrap_ref_decay_t<Args>...>) {
+                                return std::make_from_tuple<T>(std::move(args));
+                            } else {
+                                return std::make_from_tuple<T>(args);
+                            }
+                        }) {
+    }
+    // Builds the result of `factory()` on first use
+    template <class F>
+    LazySharedPtr(FromFactory, F&& factory)
+        : factory_(new FactoryOf<std::decay_t<F>>(std::forward<F>(factory))), block_(Allocate()) {
+    }
+    LazySharedPtr(const LazySharedPtr& other) = delete;
+    LazySharedPtr& operator=(const LazySharedPtr& other) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~LazySharedPtr() {
+        if (!IsBuilt()) {
+            Deallocate(block_);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() {
+        if (!built_.load(std::memory_order_acquire)) {
+            Build();
+        }
+        return owner_.Get();
+    }
+    T& operator*() {
+        return *Get();
+    }
+    T* operator->() {
+        return Get();
+    }
+    bool IsBuilt() const {
+        return built_.load(std::memory_order_acquire);
+    }
+
+    SharedPtr<T> GetShared() {
+        Get();
+        return owner_;
+    }
+    WeakPtr<T> GetWeak() {
+        Get();
+        return WeakPtr<T>(owner_);
+    }
+
+private:
+    using Block = ObjectBlock<T>;
+
+    template <typename... Args>
+    static constexpr bool kMoveArgs =
+        std::is_nothrow_constructible_v<T, Args&&...> || !std::is_constructible_v<T, Args&...>;
+
+    // Type-erased factory; unlike `std::function` it takes move-only callables
+    struct Factory {
+        virtual ~Factory() = default;
+        virtual T Make() = 0;
+    };
+    template <class F>
+    struct FactoryOf : Factory {
+        template <class G>
+        explicit FactoryOf(G&& factory) : factory(std::forward<G>(factory)) {
+        }
+        T Make() override {
+            return factory();
+        }
+
+        F factory;
+    };
+
+    static constexpr bool kOverAligned = alignof(Block) > __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+    // Same memory `delete` on the block gives back once it holds an object
+    static Block* Allocate() {
+        if constexpr (kOverAligned) {
+            auto memory = ::operator new(sizeof(Block), std::align_val_t(alignof(Block)));
+            return static_cast<Block*>(memory);
+        } else {
+            return static_cast<Block*>(::operator new(sizeof(Block)));
+        }
+    }
+    static void Deallocate(Block* block) {
+        if constexpr (kOverAligned) {
+            ::operator delete(block, std::align_val_t(alignof(Block)));
+        } else {
+            ::operator delete(block);
+        }
+    }
+
+    void Build() {
+        std::call_once(once_, [this] {
+            auto make = [this] { return factory_->Make(); };
+            owner_ = SharedPtr<T>(new (block_) Block(FromFactory(), make));
+            factory_.Reset();
+            built_.store(true, std::memory_order_release);
+        });
+    }
+
+    UniquePtr<Factory> factory_;
+    Block* block_;
+    SharedPtr<T> owner_;
+    std::atomic<bool> built_ = false;
+    std::once_flag once_;
+};
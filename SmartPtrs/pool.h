@@ -0,0 +1,280 @@
+#pragma once
+
+#include "shared.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Pool of ready-made objects handed out as `SharedPtr`s. When the last reference goes away the
+// object is not destroyed: the reset hook runs and the object goes back to the pool together
+// with its control block, so acquiring from a warm pool neither allocates nor constructs.
+//
+// Returned objects first fill a small cache of the releasing thread, then the pool's shared
+// list. Caches and list together keep at most `capacity` objects; anything beyond that is
+// destroyed. Objects may outlive the pool: once it is gone they are simply destroyed on release.
+// The destroying thread frees its own cached objects at once; objects cached by other threads
+// are freed the next time those threads use a pool of the same type, or when they exit.
+template <typename T>
+class ObjectPool {
+    static_assert(!std::is_convertible_v<T*, EnableBase*>,
+                  "a pooled object would keep its block alive through WeakFromThis");
+
+public:
+    using ResetHook = std::function<void(T&)>;
+    using Factory = std::function<T()>;
+
+    static constexpr size_t kThreadCacheSize = 16;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    explicit ObjectPool(size_t capacity, ResetHook reset = nullptr,
+                        Factory factory = [] { return T(); })
+        : core_(new Core(capacity, std::move(reset), std::move(factory))) {
+    }
+    ObjectPool(const ObjectPool& other) = delete;
+    ObjectPool& operator=(const ObjectPool& other) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~ObjectPool() {
+        std::vector<Block*> idle;
+        {
+            std::lock_guard lock(core_->mutex);
+            core_->closed.store(true, std::memory_order_relaxed);
+            idle.swap(core_->idle);
+        }
+        for (auto block : idle) {
+            delete block;
+        }
+        if (auto cache = Local()) {
+            cache->Drop(core_);
+        }
+        core_->Unref();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    SharedPtr<T> Acquire() {
+        Block* block = nullptr;
+        if (auto cache = Local()) {
+            block = cache->Take(core_);
+        }
+        if (block == nullptr) {
+            std::lock_guard lock(core_->mutex);
+            if (!core_->idle.empty()) {
+                block = core_->idle.back();
+                core_->idle.pop_back();
+                core_->Unreserve();
+            }
+        }
+        if (block == nullptr) {
+            block = new Block(core_);
+        } else {
+            block->Revive();
+        }
+        return SharedPtr<T>(static_cast<ObjectBlock<T>*>(block));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    size_t Capacity() const {
+        return core_->capacity;
+    }
+    // Objects waiting in the shared list, not counting thread caches
+    size_t Idle() const {
+        std::lock_guard lock(core_->mutex);
+        return core_->idle.size();
+    }
+
+private:
+    class Block;
+
+    // Outlives the pool for as long as blocks or thread caches refer to it
+    struct Core {
+        Core(size_t capacity, ResetHook reset, Factory factory)
+            : capacity(capacity), reset(std::move(reset)), factory(std::move(factory)) {
+        }
+        void Ref() {
+            refs.fetch_add(1, std::memory_order_relaxed);
+        }
+        void Unref() {
+            if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                delete this;
+            }
+        }
+        // Returns false if the block has to be destroyed instead
+        bool PutIdle(Block* block) {
+            std::lock_guard lock(mutex);
+            if (closed.load(std::memory_order_relaxed) || !Reserve()) {
+                return false;
+            }
+            idle.push_back(block);
+            return true;
+        }
+        // Takes one of the `capacity` places shared by the list and the thread caches
+        bool Reserve() {
+            size_t count = kept.load(std::memory_order_relaxed);
+            do {
+                if (count >= capacity) {
+                    return false;
+                }
+            } while (!kept.compare_exchange_weak(count, count + 1, std::memory_order_relaxed));
+            return true;
+        }
+        void Unreserve() {
+            kept.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        const size_t capacity;
+        const ResetHook reset;
+        const Factory factory;
+        mutable std::mutex mutex;
+        std::vector<Block*> idle;
+        std::atomic<bool> closed = false;
+        std::atomic<size_t> kept = 0;
+        std::atomic<size_t> refs = 1;
+    };
+
+    class Block : public ObjectBlock<T> {
+    public:
+        explicit Block(Core* core) : ObjectBlock<T>(FromFactory(), core->factory), core_(core) {
+            core_->Ref();
+        }
+        ~Block() {
+            core_->Unref();
+        }
+        // Last strong reference is gone: reset instead of destroying
+        void Nullify() override {
+            if (core_->reset) {
+                core_->reset(*this->Get());
+            }
+        }
+        // Last reference of any kind is gone: recycle the block
+        void Destroy() override {
+            auto cache = Local();
+            bool kept = cache != nullptr ? cache->Put(core_, this) : core_->PutIdle(this);
+            if (!kept) {
+                delete this;
+            }
+        }
+        void Revive() {
+            this->cnt_ = 1;
+        }
+
+    private:
+        Core* core_;
+    };
+
+    // Per-thread free lists, one for every pool the thread has touched
+    class ThreadCache {
+    public:
+        explicit ThreadCache(bool* gone) : gone_(gone) {
+        }
+        ~ThreadCache() {
+            *gone_ = true;
+            for (auto& [core, blocks] : lists_) {
+                for (auto block : blocks) {
+                    core->Unreserve();
+                    if (!core->PutIdle(block)) {
+                        delete block;
+                    }
+                }
+                core->Unref();
+            }
+        }
+
+        Block* Take(Core* core) {
+            DropClosed();
+            auto list = Find(core);
+            if (list == nullptr || list->empty()) {
+                return nullptr;
+            }
+            Block* block = list->back();
+            list->pop_back();
+            core->Unreserve();
+            return block;
+        }
+        // Returns false if the block has to be destroyed instead
+        bool Put(Core* core, Block* block) {
+            DropClosed();
+            if (core->closed.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            auto list = Find(core);
+            if (list == nullptr) {
+                core->Ref();
+                list = &lists_.emplace_back(core, std::vector<Block*>()).second;
+            }
+            if (list->size() < std::min(kThreadCacheSize, core->capacity) && core->Reserve()) {
+                list->push_back(block);
+                return true;
+            }
+            return core->PutIdle(block);
+        }
+        void Drop(Core* core) {
+            Free(Extract([core](Core* owner) { return owner == core; }));
+        }
+
+    private:
+        using List = std::pair<Core*, std::vector<Block*>>;
+
+        // Frees what this thread still caches for pools destroyed by other threads
+        void DropClosed() {
+            Free(Extract(
+                [](Core* owner) { return owner->closed.load(std::memory_order_relaxed); }));
+        }
+        // Lists are taken out before anything is freed: destroying an object may release other
+        // pooled objects and so re-enter the cache
+        template <class Pred>
+        std::vector<List> Extract(Pred pred) {
+            std::vector<List> taken;
+            for (size_t i = lists_.size(); i-- > 0;) {
+                if (pred(lists_[i].first)) {
+                    taken.push_back(std::move(lists_[i]));
+                    lists_.erase(lists_.begin() + i);
+                }
+            }
+            return taken;
+        }
+        static void Free(std::vector<List> lists) {
+            for (auto& [core, blocks] : lists) {
+                for (auto block : blocks) {
+                    delete block;
+                }
+                core->Unref();
+            }
+        }
+
+        std::vector<Block*>* Find(Core* core) {
+            for (auto& [owner, blocks] : lists_) {
+                if (owner == core) {
+                    return &blocks;
+                }
+            }
+            return nullptr;
+        }
+        bool* gone_;
+        std::vector<List> lists_;
+    };
+
+    // Null while the calling thread is being torn down
+    static ThreadCache* Local() {
+        thread_local bool gone = false;
+        if (gone) {
+            return nullptr;
+        }
+        thread_local ThreadCache cache(&gone);
+        return &cache;
+    }
+
+    Core* core_;
+};
@@ -1,8 +1,17 @@
 #pragma once
 
 #include "sw_fwd.h"  // Forward declaration
+#include "compressed_pair.h"
+#include "unique.h"
 
+#include <compare>
 #include <cstddef>  // std::nullptr_t
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 // https://en.cppreference.com/w/cpp/memory/shared_ptr
 class ControlBlock {
@@ -33,16 +42,57 @@ public:
     }
     virtual void Nullify() {
     }
+    // Called once both counts reach zero
+    virtual void Destroy() {
+        delete this;
+    }
     bool IsObj() const {
         return obj;
     }
 
+    // Drops one strong reference; the object dies with the last one, the block with the last
+    // reference of any kind. The extra weak reference keeps the block alive while the object's
+    // destructor runs, since that may release weak references to the same block.
+    void Release() {
+        Del();
+        if (cnt_ == 0) {
+            AddWeak();
+            Nullify();
+            DelWeak();
+            if (weak_cnt_ == 0) {
+                Destroy();
+            }
+        } else if (traced_) {
+            Suspect();
+        }
+    }
+    void ReleaseWeak() {
+        DelWeak();
+        if (cnt_ + weak_cnt_ == 0) {
+            Destroy();
+        }
+    }
+
+    // Cycle collection hooks, see cycle.h
+    bool IsTraced() const {
+        return traced_;
+    }
+    virtual void Suspect() {
+    }
+    virtual TracedNode* AsTraced() {
+        return nullptr;
+    }
+
 protected:
     size_t cnt_;
     size_t weak_cnt_;
     bool obj;
+    bool traced_ = false;
 };
 
+// Tag for building the object in place from the result of a callable
+struct FromFactory {};
+
 template <class T>
 class ObjectBlock : public ControlBlock {
 public:
@@ -53,9 +103,16 @@ public:
         obj = true;
         weak_cnt_ = 0;
     }
+    template <class F>
+    ObjectBlock(FromFactory, F&& factory) {
+        new (&obj_) T(std::forward<F>(factory)());
+        cnt_ = 1;
+        obj = true;
+        weak_cnt_ = 0;
+    }
     void Nullify() {
-        reinterpret_cast<T*>(&obj_)->~T();
         cleared_ = true;
+        reinterpret_cast<T*>(&obj_)->~T();
     }
     ~ObjectBlock() {
         if (!cleared_) {
@@ -75,15 +132,14 @@ template <class T>
 class PointerBlock : public ControlBlock {
 public:
     PointerBlock(T* ptr) : ptr_(ptr) {
-        if (ptr != nullptr) {
-            Add();
-        }
+        Add();
         obj = false;
     }
 
     void Nullify() {
-        delete ptr_;
+        T* ptr = ptr_;
         ptr_ = nullptr;
+        delete ptr;
     }
     ~PointerBlock() {
         delete ptr_;
@@ -95,35 +151,134 @@ public:
 private:
     T* ptr_ = nullptr;
 };
+// Owner of an object created with a custom deleter, e.g. one promoted from `UniquePtr`
+template <class T, class Deleter>
+class DeleterBlock : public ControlBlock {
+public:
+    DeleterBlock(T* ptr, Deleter deleter) : data_(ptr, std::move(deleter)) {
+        Add();
+        obj = false;
+    }
+
+    void Nullify() {
+        T* ptr = data_.GetFirst();
+        data_.GetFirst() = nullptr;
+        if (ptr != nullptr) {
+            data_.GetSecond()(ptr);
+        }
+    }
+    ~DeleterBlock() {
+        Nullify();
+    }
+
+private:
+    CompressedPair<T*, Deleter> data_;
+};
+
+// Deleter of `MakeUniqueShareable` objects. They already live inside an `ObjectBlock`, so
+// promoting them to `SharedPtr` reuses the block instead of allocating one. The block is only
+// used for the pointer it was made for; anything else handed over later, e.g. by `Reset`, is
+// an ordinary heap object. Moving the deleter moves the block along.
+template <class T>
+struct BlockDeleter {
+    BlockDeleter() {
+    }
+    BlockDeleter(ControlBlock* block, T* payload) : block_(block), payload_(payload) {
+    }
+    BlockDeleter(const BlockDeleter& other) = delete;
+    BlockDeleter(BlockDeleter&& other) : block_(other.block_), payload_(other.payload_) {
+        other.Forget();
+    }
+    template <class Y>
+    BlockDeleter(BlockDeleter<Y>&& other) : block_(other.block_), payload_(other.payload_) {
+        other.Forget();
+    }
+    BlockDeleter& operator=(const BlockDeleter& other) = delete;
+    BlockDeleter& operator=(BlockDeleter&& other) {
+        if (this != &other) {
+            block_ = other.block_;
+            payload_ = other.payload_;
+            other.Forget();
+        }
+        return *this;
+    }
+
+    void operator()(T* ptr) {
+        if (ptr == nullptr) {
+            return;
+        }
+        if (Owns(ptr)) {
+            ControlBlock* block = block_;
+            Forget();
+            block->Destroy();
+        } else {
+            delete ptr;
+        }
+    }
+
+    bool Owns(T* ptr) const {
+        return block_ != nullptr && ptr == payload_;
+    }
+    // Hands the block over to a new owner
+    ControlBlock* Take() {
+        ControlBlock* block = block_;
+        Forget();
+        return block;
+    }
+
+private:
+    template <class Y>
+    friend struct BlockDeleter;
+
+    void Forget() {
+        block_ = nullptr;
+        payload_ = nullptr;
+    }
+
+    ControlBlock* block_ = nullptr;
+    T* payload_ = nullptr;
+};
+
 class EnableBase {};
 template <typename T>
 class EnableSharedFromThis : public EnableBase {
 public:
+    EnableSharedFromThis() {
+    }
+    // The self-reference belongs to the owning block, not to the object value
+    EnableSharedFromThis(const EnableSharedFromThis&) {
+    }
+    EnableSharedFromThis& operator=(const EnableSharedFromThis&) {
+        return *this;
+    }
+
     SharedPtr<T> SharedFromThis() {
-        return SharedPtr<T>(this->block_, dynamic_cast<T*>(ptr_));
+        return SharedPtr<T>(weak_this_);
     }
     SharedPtr<const T> SharedFromThis() const {
-        return SharedPtr<const T>(this->block_, dynamic_cast<const T*>(ptr_));
+        return SharedPtr<const T>(weak_this_);
     }
 
     WeakPtr<T> WeakFromThis() noexcept {
-        return WeakPtr<T>(SharedFromThis());
+        return weak_this_;
     }
     WeakPtr<const T> WeakFromThis() const noexcept {
-        return WeakPtr<const T>(SharedFromThis());
-    }
-    virtual void Null() {
-    }
-    void Setter(ControlBlock* block, T* ptr) {
-        block_ = block;
-        ptr_ = ptr;
+        return weak_this_;
     }
 
 private:
-    ControlBlock* block_ = nullptr;
-    T* ptr_ = nullptr;
+    // Set once, when the first owner is created by `MakeShared` or `SharedPtr(Y*)`
+    template <class Y>
+    void InitWeakThis(ControlBlock* block, Y* ptr) {
+        if (weak_this_.Expired()) {
+            weak_this_ = WeakPtr<T>(block, static_cast<T*>(ptr));
+        }
+    }
+
+    WeakPtr<T> weak_this_;
 
-    friend class SharedPtr<T>;
+    template <typename Y>
+    friend class SharedPtr;
 };
 
 template <typename T>
@@ -143,9 +298,7 @@ public:
     explicit SharedPtr(Y* ptr) {
         data_ = static_cast<T*>(ptr);
         block_ = new PointerBlock<Y>(ptr);
-        if constexpr (std::is_convertible_v<Y, EnableBase>) {
-            ptr->Setter(block_, ptr);
-        }
+        InitWeakThis(ptr);
     }
     template <class Y>
     SharedPtr(const SharedPtr<Y>& other) {
@@ -154,17 +307,12 @@ public:
         if (block_ != nullptr) {
             block_->Add();
         }
-        if constexpr (std::is_convertible_v<Y, EnableBase>) {
-            data_ > Setter(block_, data_);
-        }
     }
     template <class Y>
     SharedPtr(ObjectBlock<Y>* block) {
         this->block_ = block;
         this->data_ = static_cast<T*>(block->Get());
-        if constexpr (std::is_convertible_v<Y, EnableBase>) {
-            data_->Setter(block_, data_);
-        }
+        InitWeakThis(block->Get());
     }
     SharedPtr(const SharedPtr& other) {
         data_ = other.data_;
@@ -172,9 +320,6 @@ public:
         if (block_ != nullptr) {
             block_->Add();
         }
-        if constexpr (std::is_convertible_v<T, EnableBase>) {
-            data_->Setter(block_, data_);
-        }
     }
     template <class Y>
     SharedPtr(SharedPtr<Y>&& other) {
@@ -190,16 +335,38 @@ public:
         other.block_ = nullptr;
     }
 
+    // Promote `UniquePtr`, keeping its deleter
+    // #13 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
+    template <class Y, class Deleter>
+    SharedPtr(UniquePtr<Y, Deleter>&& other) {
+        Y* ptr = other.Get();
+        if (ptr == nullptr) {
+            return;
+        }
+        if constexpr (std::is_same_v<Deleter, BlockDeleter<Y>>) {
+            if (other.GetDeleter().Owns(ptr)) {
+                block_ = other.GetDeleter().Take();
+            }
+        }
+        if (block_ == nullptr) {
+            block_ = new DeleterBlock<Y, Deleter>(ptr, std::move(other.GetDeleter()));
+        }
+        data_ = static_cast<T*>(other.Release());
+        InitWeakThis(ptr);
+    }
+
     // Aliasing constructor
     // #8 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
     template <typename Y>
     SharedPtr(const SharedPtr<Y>& other, T* ptr) {
         this->block_ = other.block_;
-        block_->Add();
+        if (block_ != nullptr) {
+            block_->Add();
+        }
         this->data_ = ptr;
     }
 
-    SharedPtr(ControlBlock* block, T* data) : block_(block), data_(data) {
+    SharedPtr(ControlBlock* block, T* data) : data_(data), block_(block) {
         if (block_ != nullptr) {
             block_->Add();
         }
@@ -207,89 +374,36 @@ public:
 
     // Promote `WeakPtr`
     // #11 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
-    explicit SharedPtr(const WeakPtr<T>& other) {
-        this->block_ = other.GetBlock();
-        this->data_ = other.Get();
-        if (this->block_ != nullptr) {
-            if (this->block_->GetCnt() == 0) {
-                throw BadWeakPtr();
-            }
-            block_->Add();
+    template <class Y>
+    explicit SharedPtr(const WeakPtr<Y>& other) {
+        if (other.Expired()) {
+            throw BadWeakPtr();
         }
+        this->block_ = other.GetBlock();
+        this->data_ = static_cast<T*>(other.Get());
+        block_->Add();
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // `operator=`-s
     template <class Y>
     SharedPtr& operator=(const SharedPtr<Y>& other) {
-        if (*data_ == *static_cast<T*>(other.data_)) {
-            return *this;
-        }
-        if (block_ != nullptr) {
-            block_->Del();
-            if (block_->GetCnt() == 0) {
-                delete block_;
-            }
-        }
-
-        data_ = static_cast<T*>(other.data_);
-        block_ = other.block_;
-        if (block_ != nullptr) {
-            block_->Add();
-        }
+        SharedPtr(other).Swap(*this);
         return *this;
     }
 
     SharedPtr& operator=(const SharedPtr& other) {
-        if (data_ == other.data_) {
-            return *this;
-        }
-        if (block_ != nullptr) {
-            block_->Del();
-            if (block_->GetCnt() == 0) {
-                delete block_;
-            }
-        }
-
-        data_ = other.data_;
-        block_ = other.block_;
-        if (block_ != nullptr) {
-            block_->Add();
-        }
+        SharedPtr(other).Swap(*this);
         return *this;
     }
     template <class Y>
     SharedPtr& operator=(SharedPtr<Y>&& other) {
-        if (*data_ == *static_cast<T*>(other.data_)) {
-            return *this;
-        }
-        if (block_ != nullptr) {
-            block_->Del();
-            if (block_->GetCnt() == 0) {
-                delete block_;
-            }
-        }
-        data_ = static_cast<T*>(other.data_);
-        block_ = other.block_;
-        other.data_ = nullptr;
-        other.block_ = nullptr;
+        SharedPtr(std::move(other)).Swap(*this);
         return *this;
     }
 
     SharedPtr& operator=(SharedPtr&& other) {
-        if (data_ == other.data_) {
-            return *this;
-        }
-        if (block_ != nullptr) {
-            block_->Del();
-            if (block_->GetCnt() == 0) {
-                delete block_;
-            }
-        }
-        data_ = other.data_;
-        block_ = other.block_;
-        other.data_ = nullptr;
-        other.block_ = nullptr;
+        SharedPtr(std::move(other)).Swap(*this);
         return *this;
     }
 
@@ -297,42 +411,20 @@ public:
     // Destructor
 
     ~SharedPtr() {
-        data_ = nullptr;
-        if (block_ != nullptr) {
-            block_->Del();
-            if (block_->GetCnt() == 0 && block_->GetWeakCnt() == 0) {
-                delete block_;
-                block_ = nullptr;
-            } else if (block_->GetCnt() == 0) {
-                block_->Nullify();
-            }
-        }
+        Release();
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Modifiers
 
     void Reset() {
+        Release();
         data_ = nullptr;
-        if (block_ != nullptr) {
-            block_->Del();
-            if (block_->GetCnt() == 0) {
-                delete block_;
-                block_ = nullptr;
-            }
-        }
+        block_ = nullptr;
     }
     template <class Y>
     void Reset(Y* ptr) {
-        data_ = static_cast<T*>(ptr);
-        if (block_ != nullptr) {
-            block_->Del();
-            if (block_->GetCnt() == 0) {
-                delete block_;
-                block_ = nullptr;
-            }
-        }
-        block_ = new PointerBlock<Y>(ptr);
+        SharedPtr(ptr).Swap(*this);
     }
     void Swap(SharedPtr& other) {
         std::swap(this->block_, other.block_);
@@ -363,18 +455,152 @@ public:
     ControlBlock* GetBlock() const {
         return block_;
     }
+    // Orders by control block, so aliases of one object are equivalent
+    template <class Y>
+    bool OwnerBefore(const SharedPtr<Y>& other) const {
+        return std::less<ControlBlock*>()(block_, other.GetBlock());
+    }
+    template <class Y>
+    bool OwnerBefore(const WeakPtr<Y>& other) const {
+        return std::less<ControlBlock*>()(block_, other.GetBlock());
+    }
 
 private:
+    template <class Y>
+    void InitWeakThis(Y* ptr) {
+        if constexpr (std::is_convertible_v<Y*, EnableBase*>) {
+            if (ptr != nullptr) {
+                ptr->InitWeakThis(block_, ptr);
+            }
+        }
+    }
+
+    void Release() {
+        if (block_ != nullptr) {
+            block_->Release();
+        }
+    }
+
     T* data_ = nullptr;
     ControlBlock* block_ = nullptr;
 };
 
 template <typename T, typename U>
 inline bool operator==(const SharedPtr<T>& left, const SharedPtr<U>& right) {
-    return left.GetBlock();
+    return left.Get() == right.Get();
+}
+template <typename T, typename U>
+inline std::strong_ordering operator<=>(const SharedPtr<T>& left, const SharedPtr<U>& right) {
+    return std::compare_three_way()(left.Get(), right.Get());
+}
+template <typename T>
+inline bool operator==(const SharedPtr<T>& left, std::nullptr_t) {
+    return left.Get() == nullptr;
+}
+template <typename T>
+inline std::strong_ordering operator<=>(const SharedPtr<T>& left, std::nullptr_t) {
+    return std::compare_three_way()(left.Get(), static_cast<T*>(nullptr));
+}
+
+// Pointers are aligned, so their low bits carry nothing; fold the high bits in before use
+// as a bucket index (finalizer of MurmurHash3)
+inline size_t HashPointer(const void* ptr) {
+    uint64_t x = reinterpret_cast<uintptr_t>(ptr);
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return static_cast<size_t>(x);
 }
+
+template <typename T>
+struct std::hash<SharedPtr<T>> {
+    size_t operator()(const SharedPtr<T>& ptr) const {
+        return HashPointer(ptr.Get());
+    }
+};
+
 // Allocate memory only once
 template <typename T, typename... Args>
 SharedPtr<T> MakeShared(Args&&... args) {
     return SharedPtr<T>(new ObjectBlock<T>(std::forward<Args>(args)...));
 }
+
+// A `UniquePtr` whose object sits in a ready control block: converting it to `SharedPtr`
+// takes no allocation
+template <typename T, typename... Args>
+UniquePtr<T, BlockDeleter<T>> MakeUniqueShareable(Args&&... args) {
+    auto block = new ObjectBlock<T>(std::forward<Args>(args)...);
+    return UniquePtr<T, BlockDeleter<T>>(block->Get(), BlockDeleter<T>(block, block->Get()));
+}
+
+// One slab holding `n` object blocks back to back; each keeps its own counts and the slab
+// memory goes away together with the last of them
+template <class T>
+class SlabBlock : public ObjectBlock<T> {
+public:
+    struct Header {
+        size_t live;
+    };
+
+    template <class F>
+    SlabBlock(Header* slab, F&& factory)
+        : ObjectBlock<T>(FromFactory(), std::forward<F>(factory)), slab_(slab) {
+    }
+    void Destroy() override {
+        Header* slab = slab_;
+        this->~SlabBlock();
+        if (--slab->live == 0) {
+            Free(slab);
+        }
+    }
+
+    static constexpr size_t Offset() {
+        return (sizeof(Header) + alignof(SlabBlock) - 1) / alignof(SlabBlock) * alignof(SlabBlock);
+    }
+    static Header* Allocate(size_t n) {
+        void* memory = ::operator new(Offset() + n * sizeof(SlabBlock),
+                                      std::align_val_t(alignof(SlabBlock)));
+        return new (memory) Header{n};
+    }
+    static void Free(Header* slab) {
+        ::operator delete(slab, std::align_val_t(alignof(SlabBlock)));
+    }
+    static SlabBlock* Blocks(Header* slab) {
+        return reinterpret_cast<SlabBlock*>(reinterpret_cast<char*>(slab) + Offset());
+    }
+
+private:
+    Header* slab_;
+};
+
+// `n` objects in a single allocation, the i-th one built from `init(i)`
+template <typename T, typename F>
+std::vector<SharedPtr<T>> MakeSharedBatch(size_t n, F&& init) {
+    std::vector<SharedPtr<T>> result;
+    if (n == 0) {
+        return result;
+    }
+    result.reserve(n);
+    auto slab = SlabBlock<T>::Allocate(n);
+    auto blocks = SlabBlock<T>::Blocks(slab);
+    size_t built = 0;
+    try {
+        for (; built < n; ++built) {
+            new (blocks + built) SlabBlock<T>(slab, [&init, built] { return init(built); });
+        }
+    } catch (...) {
+        for (size_t i = 0; i < built; ++i) {
+            blocks[i].~SlabBlock<T>();
+        }
+        SlabBlock<T>::Free(slab);
+        throw;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        result.emplace_back(static_cast<ObjectBlock<T>*>(blocks + i));
+    }
+    return result;
+}
+
+#include "weak.h"  // EnableSharedFromThis keeps a WeakPtr
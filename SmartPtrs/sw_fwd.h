@@ -10,3 +10,5 @@ class SharedPtr;
 
 template <typename T>
 class WeakPtr;
+
+class TracedNode;
@@ -3,6 +3,10 @@
 #include "compressed_pair.h"
 
 #include <cstddef>  // std::nullptr_t
+#include <cstdint>
+#include <new>
+#include <span>
+#include <type_traits>
 #include <typeinfo>
 template <typename T>
 struct DefaultDeleter {
@@ -26,6 +30,94 @@ struct DefaultDeleter<T[]> {
         delete[] obj;
     }
 };
+// Raw storage for arrays made by `MakeUnique<T[]>`: no array cookie, sized (and, past the
+// default `new` alignment, aligned) deallocation
+template <typename T, size_t Align>
+struct ArrayStorage {
+    static_assert((Align & (Align - 1)) == 0, "alignment must be a power of two");
+    static_assert(Align >= alignof(T), "alignment must not be weaker than the element's");
+
+    static constexpr bool kOverAligned = Align > __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+    template <bool ValueInit>
+    static T* Allocate(size_t size) {
+        if (size > SIZE_MAX / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        T* ptr;
+        if constexpr (kOverAligned) {
+            ptr = static_cast<T*>(::operator new(size * sizeof(T), std::align_val_t(Align)));
+        } else {
+            ptr = static_cast<T*>(::operator new(size * sizeof(T)));
+        }
+        size_t built = 0;
+        try {
+            for (; built < size; ++built) {
+                if constexpr (ValueInit) {
+                    new (ptr + built) T();
+                } else {
+                    new (ptr + built) T;
+                }
+            }
+        } catch (...) {
+            Destroy(ptr, built);
+            Deallocate(ptr, size);
+            throw;
+        }
+        return ptr;
+    }
+    static void Destroy(T* ptr, size_t size) {
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            while (size > 0) {
+                ptr[--size].~T();
+            }
+        }
+    }
+    static void Deallocate(T* ptr, size_t size) {
+        if constexpr (kOverAligned) {
+            ::operator delete(ptr, size * sizeof(T), std::align_val_t(Align));
+        } else {
+            ::operator delete(ptr, size * sizeof(T));
+        }
+    }
+};
+
+// Deleter that knows the array length. A length fixed at compile time takes no space, so the
+// `UniquePtr` stays one pointer wide.
+template <typename T, size_t Extent = std::dynamic_extent, size_t Align = alignof(T)>
+struct ArrayDeleter {
+    ArrayDeleter() {
+    }
+    size_t Size() const {
+        return Extent;
+    }
+    void operator()(T* ptr) {
+        if (ptr != nullptr) {
+            ArrayStorage<T, Align>::Destroy(ptr, Extent);
+            ArrayStorage<T, Align>::Deallocate(ptr, Extent);
+        }
+    }
+};
+template <typename T, size_t Align>
+struct ArrayDeleter<T, std::dynamic_extent, Align> {
+    ArrayDeleter() {
+    }
+    explicit ArrayDeleter(size_t size) : size_(size) {
+    }
+    size_t Size() const {
+        return size_;
+    }
+    void operator()(T* ptr) {
+        if (ptr != nullptr) {
+            ArrayStorage<T, Align>::Destroy(ptr, size_);
+            ArrayStorage<T, Align>::Deallocate(ptr, size_);
+        }
+    }
+
+private:
+    size_t size_ = 0;
+};
+
 // Primary template
 template <typename T, typename Deleter = DefaultDeleter<T>>
 class UniquePtr {
@@ -252,6 +344,17 @@ public:
     T& operator[](size_t ind) {
         return data_.GetFirst()[ind];
     }
+    // Only for deleters that know the length, like the ones of `MakeUnique<T[]>`
+    size_t Size() const
+        requires requires(const Deleter& deleter) { deleter.Size(); }
+    {
+        return Get() != nullptr ? GetDeleter().Size() : 0;
+    }
+    std::span<T> Span() const
+        requires requires(const Deleter& deleter) { deleter.Size(); }
+    {
+        return std::span<T>(Get(), Size());
+    }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Single-object dereference operators
@@ -266,3 +369,51 @@ public:
 private:
     CompressedPair<T*, Deleter> data_;
 };
+
+template <typename T, typename... Args>
+    requires(!std::is_array_v<T>)
+UniquePtr<T> MakeUnique(Args&&... args) {
+    return UniquePtr<T>(new T(std::forward<Args>(args)...));
+}
+
+// `n` value-initialized elements; pass `Align`, e.g. 64, for SIMD buffers
+template <typename T, size_t Align = alignof(std::remove_extent_t<T>)>
+    requires std::is_unbounded_array_v<T>
+UniquePtr<T, ArrayDeleter<std::remove_extent_t<T>, std::dynamic_extent, Align>> MakeUnique(
+    size_t n) {
+    using Element = std::remove_extent_t<T>;
+    return UniquePtr<T, ArrayDeleter<Element, std::dynamic_extent, Align>>(
+        ArrayStorage<Element, Align>::template Allocate<true>(n),
+        ArrayDeleter<Element, std::dynamic_extent, Align>(n));
+}
+
+// Heap array of a length known at compile time, held by a one-pointer `UniquePtr`
+template <typename T, size_t Align = alignof(std::remove_extent_t<T>)>
+    requires std::is_bounded_array_v<T>
+UniquePtr<std::remove_extent_t<T>[], ArrayDeleter<std::remove_extent_t<T>, std::extent_v<T>, Align>>
+MakeUnique() {
+    using Element = std::remove_extent_t<T>;
+    return UniquePtr<Element[], ArrayDeleter<Element, std::extent_v<T>, Align>>(
+        ArrayStorage<Element, Align>::template Allocate<true>(std::extent_v<T>));
+}
+
+// As `MakeUnique`, but elements are default-initialized: scratch buffers of trivial types
+// are left unwritten
+template <typename T, size_t Align = alignof(std::remove_extent_t<T>)>
+    requires std::is_unbounded_array_v<T>
+UniquePtr<T, ArrayDeleter<std::remove_extent_t<T>, std::dynamic_extent, Align>>
+MakeUniqueForOverwrite(size_t n) {
+    using Element = std::remove_extent_t<T>;
+    return UniquePtr<T, ArrayDeleter<Element, std::dynamic_extent, Align>>(
+        ArrayStorage<Element, Align>::template Allocate<false>(n),
+        ArrayDeleter<Element, std::dynamic_extent, Align>(n));
+}
+
+template <typename T, size_t Align = alignof(std::remove_extent_t<T>)>
+    requires std::is_bounded_array_v<T>
+UniquePtr<std::remove_extent_t<T>[], ArrayDeleter<std::remove_extent_t<T>, std::extent_v<T>, Align>>
+MakeUniqueForOverwrite() {
+    using Element = std::remove_extent_t<T>;
+    return UniquePtr<Element[], ArrayDeleter<Element, std::extent_v<T>, Align>>(
+        ArrayStorage<Element, Align>::template Allocate<false>(std::extent_v<T>));
+}
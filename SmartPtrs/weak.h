@@ -9,11 +9,13 @@ public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Constructors
 
+    template <typename Y>
+    friend class WeakPtr;
     WeakPtr() {
-        block_ = nullptr;
     }
     template <class Y>
     WeakPtr(const WeakPtr<Y>& other) {
+        data_ = static_cast<T*>(other.data_);
         block_ = other.block_;
         if (block_ != nullptr) {
             block_->AddWeak();
@@ -21,6 +23,7 @@ public:
     }
 
     WeakPtr(const WeakPtr& other) {
+        data_ = other.data_;
         block_ = other.block_;
         if (block_ != nullptr) {
             block_->AddWeak();
@@ -29,74 +32,49 @@ public:
 
     template <class Y>
     WeakPtr(WeakPtr<Y>&& other) {
+        data_ = static_cast<T*>(other.data_);
         block_ = other.block_;
+        other.data_ = nullptr;
         other.block_ = nullptr;
     }
 
     WeakPtr(WeakPtr&& other) {
+        data_ = other.data_;
         block_ = other.block_;
+        other.data_ = nullptr;
         other.block_ = nullptr;
     }
 
+    WeakPtr(ControlBlock* block, T* data) : data_(data), block_(block) {
+        if (block_ != nullptr) {
+            block_->AddWeak();
+        }
+    }
+
     // Demote `SharedPtr`
     // #2 from https://en.cppreference.com/w/cpp/memory/weak_ptr/weak_ptr
-    WeakPtr(const SharedPtr<T>& other) {
-        if (other.GetBlock() != nullptr) {
-            other.GetBlock()->AddWeak();
-        }
-        this->block_ = other.GetBlock();
+    template <class Y>
+    WeakPtr(const SharedPtr<Y>& other) : WeakPtr(other.GetBlock(), other.Get()) {
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // `operator=`-s
     template <class Y>
     WeakPtr& operator=(const WeakPtr<Y>& other) {
-        if (block_ != nullptr) {
-            block_->DelWeak();
-            if (block_->GetWeakCnt() + block_->GetCnt() == 0) {
-                delete block_;
-            }
-        }
-        block_ = other.block_;
-        if (block_ != nullptr) {
-            block_->AddWeak();
-        }
+        WeakPtr(other).Swap(*this);
         return *this;
     }
     WeakPtr& operator=(const WeakPtr& other) {
-        if (block_ != nullptr) {
-            block_->DelWeak();
-            if (block_->GetWeakCnt() + block_->GetCnt() == 0) {
-                delete block_;
-            }
-        }
-        block_ = other.block_;
-        if (block_ != nullptr) {
-            block_->AddWeak();
-        }
+        WeakPtr(other).Swap(*this);
         return *this;
     }
     template <class Y>
     WeakPtr& operator=(WeakPtr<Y>&& other) {
-        if (block_ != nullptr) {
-            block_->DelWeak();
-            if (block_->GetWeakCnt() + block_->GetCnt() == 0) {
-                delete block_;
-            }
-        }
-        block_ = other.block_;
-        other.block_ = nullptr;
+        WeakPtr(std::move(other)).Swap(*this);
         return *this;
     }
     WeakPtr& operator=(WeakPtr&& other) {
-        if (block_ != nullptr) {
-            block_->DelWeak();
-            if (block_->GetWeakCnt() + block_->GetCnt() == 0) {
-                delete block_;
-            }
-        }
-        block_ = other.block_;
-        other.block_ = nullptr;
+        WeakPtr(std::move(other)).Swap(*this);
         return *this;
     }
 
@@ -105,11 +83,7 @@ public:
 
     ~WeakPtr() {
         if (block_ != nullptr) {
-            block_->DelWeak();
-            if (block_->GetCnt() + block_->GetWeakCnt() == 0) {
-                delete block_;
-                block_ = nullptr;
-            }
+            block_->ReleaseWeak();
         }
     }
 
@@ -118,14 +92,13 @@ public:
 
     void Reset() {
         if (block_ != nullptr) {
-            block_->DelWeak();
-            if (block_->GetCnt() + block_->GetWeakCnt() == 0) {
-                delete block_;
-            }
+            block_->ReleaseWeak();
             block_ = nullptr;
         }
+        data_ = nullptr;
     }
     void Swap(WeakPtr& other) {
+        std::swap(data_, other.data_);
         std::swap(block_, other.block_);
     }
 
@@ -145,31 +118,58 @@ public:
         return block_->GetCnt() == 0;
     }
     SharedPtr<T> Lock() const {
-        if (block_ != nullptr) {
-            block_->Add();
-        }
-        auto ret = SharedPtr<T>(*this);
-        if (block_ != nullptr) {
-            block_->Del();
+        if (Expired()) {
+            return SharedPtr<T>();
         }
-        return ret;
+        return SharedPtr<T>(block_, data_);
     }
 
     ControlBlock* GetBlock() const {
         return block_;
     }
+    // Orders by control block, which stays put after expiry
+    template <class Y>
+    bool OwnerBefore(const WeakPtr<Y>& other) const {
+        return std::less<ControlBlock*>()(block_, other.GetBlock());
+    }
+    template <class Y>
+    bool OwnerBefore(const SharedPtr<Y>& other) const {
+        return std::less<ControlBlock*>()(block_, other.GetBlock());
+    }
 
+    // Valid only while `!Expired()`
     T* Get() const {
-        if (block_ == nullptr) {
-            return nullptr;
-        }
-        if (block_->IsObj()) {
-            return dynamic_cast<ObjectBlock<T>*>(block_)->Get();
-        } else {
-            return dynamic_cast<PointerBlock<T>*>(block_)->Get();
-        }
+        return data_;
     }
 
 private:
-    ControlBlock* block_;
+    T* data_ = nullptr;
+    ControlBlock* block_ = nullptr;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Owner-based keys: `SharedPtr`s and `WeakPtr`s of one object compare and hash alike, and a
+// `WeakPtr` key keeps its hash after expiry since it pins the control block. `WeakPtr` has no
+// `std::hash` or `operator==` of its own: key unordered containers with `OwnerHash` and
+// `OwnerEqual`
+
+struct OwnerLess {
+    template <class L, class R>
+    bool operator()(const L& left, const R& right) const {
+        return left.OwnerBefore(right);
+    }
+};
+
+struct OwnerEqual {
+    template <class L, class R>
+    bool operator()(const L& left, const R& right) const {
+        return left.GetBlock() == right.GetBlock();
+    }
+};
+
+struct OwnerHash {
+    template <class P>
+    size_t operator()(const P& ptr) const {
+        return HashPointer(ptr.GetBlock());
+    }
 };